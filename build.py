@@ -8,6 +8,6 @@ def runCmd(cmd):
 def main():
 	print("Building...")
 	runCmd("ispc renderer.ispc -h renderer_ispc.h -o renderer_ispc.obj -O2")
-	runCmd("cl main.cpp renderer_ispc.obj /std:c++20 /I./ /MD /O2 /link user32.lib kernel32.lib gdi32.lib opengl32.lib msvcrt.lib shell32.lib glfw3.lib /LIBPATH:glfw/lib-vc2022")
+	runCmd("cl main.cpp renderer_ispc.obj /std:c++20 /I./ /MD /O2 /link user32.lib kernel32.lib gdi32.lib opengl32.lib msvcrt.lib shell32.lib advapi32.lib glfw3.lib /LIBPATH:glfw/lib-vc2022")
 	
 if __name__ == "__main__": main()
\ No newline at end of file
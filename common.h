@@ -1,12 +1,69 @@
 #pragma once
 
 #define FRAMEBUFFER_COLOR_BYTES 4
-#define FRAMEBUFFER_DEPTH_BYTES 2
+// Color the framebuffer is cleared to, packed RGBA8
+#define CLEAR_COLOR 0x2a2a2a2a
+// RenderFrameParams.framebufferLayout, the order color and depth pixels are stored in
+// Linear: row-major
+#define FRAMEBUFFER_LAYOUT_LINEAR 0
+// Blocks: row-major FRAMEBUFFER_BLOCK_SIZE square blocks of row-major pixels, see resolveFramebuffer
+#define FRAMEBUFFER_LAYOUT_BLOCKS 1
+#define FRAMEBUFFER_BLOCK_SHIFT   3
+#define FRAMEBUFFER_BLOCK_SIZE    (1 << FRAMEBUFFER_BLOCK_SHIFT)
+// Framebuffers are allocated for the frame size rounded up to whole blocks, in both layouts
+#define FRAMEBUFFER_PADDED_SIZE(size) (((size) + FRAMEBUFFER_BLOCK_SIZE - 1) & ~(FRAMEBUFFER_BLOCK_SIZE - 1))
 #define VERTEX_FLOATS 6
+// RenderFrameParams.vertexFormat, how the position and normal of a vertex are stored
+// Float: VERTEX_FLOATS floats
+#define VERTEX_FORMAT_FLOAT       0
+// Quantized: 16-bit unorm position in the mesh's bounding box, then an octahedral normal as 2x16-bit snorm or, in
+// QUANTIZED8, as 2x8-bit snorm packed into one 16-bit value
+#define VERTEX_FORMAT_QUANTIZED16 1
+#define VERTEX_FORMAT_QUANTIZED8  2
+#define VERTEX_FORMAT_NUM         3
+// 16-bit values per vertex of the quantized formats
+#define VERTEX_FORMAT_SHORTS(format) ((format) == VERTEX_FORMAT_QUANTIZED16 ? 5 : 4)
+#define VERTEX_FORMAT_BYTES(format)  ((format) == VERTEX_FORMAT_FLOAT ? VERTEX_FLOATS * 4 : VERTEX_FORMAT_SHORTS(format) * 2)
 
-#if defined(ISPC)
-typedef uint16 DepthType;
-#else
-#include <stdint.h>
-typedef uint16_t DepthType;
-#endif
\ No newline at end of file
+// Screen is split into square tiles of this many pixels, each rasterized by its own task
+#define TILE_SIZE 64
+// RenderFrameParams.rasterMode, how the gang is mapped to pixels
+// Rows: one horizontal run of pixels per iteration
+#define RASTER_MODE_ROWS      0
+// Footprint: a 2D block of pixels, 4 wide and programCount / 4 tall
+#define RASTER_MODE_FOOTPRINT 1
+// RenderFrameParams.coverage debug buffer, per pixel a hit count followed by the first COVERAGE_PIXEL_INTS - 1
+// triangle indices which covered it
+#define COVERAGE_PIXEL_INTS 8
+// RenderFrameParams.cullMode, which screen space winding is culled
+#define CULL_MODE_NONE  0
+#define CULL_MODE_BACK  1
+#define CULL_MODE_FRONT 2
+// RenderFrameParams.shadingMode
+// Forward: pixels are shaded as soon as they pass the depth test
+#define SHADING_MODE_FORWARD       0
+// Deferred: rasterization only writes depth and a triangle ID, each visible pixel is shaded once afterwards
+#define SHADING_MODE_DEFERRED      1
+// Depth pre-pass: a depth only pass over all triangles, then a pass which shades where the depth is equal
+#define SHADING_MODE_DEPTH_PREPASS 2
+// Occlusion culling works on clusters of this many consecutive triangles, RenderFrameParams.clusterBounds holds the
+// object space bounding box of each as min xyz, max xyz
+#define CLUSTER_TRIANGLES     64
+#define CLUSTER_BOUNDS_FLOATS 6
+// RenderFrameParams.occlusionMode, how clusters hidden behind other geometry are found
+#define OCCLUSION_MODE_NONE      0
+// Occluders: the nearest big clusters are rasterized into a coarse masked depth buffer before binning
+#define OCCLUSION_MODE_OCCLUDERS 1
+// Temporal: the clusters visible last frame are drawn first, the rest only if they are in front of that depth
+#define OCCLUSION_MODE_TEMPORAL  2
+// Upper bound on the task system's thread count, sizes per-thread arrays on both sides
+#define RENDER_MAX_THREADS 128
+// RenderFrameParams.depthFormat, how the depth buffer stores depth, picked when the framebuffer is created
+// 16-bit unorm window z
+#define DEPTH_FORMAT_UNORM16          0
+// 24-bit unorm window z, in the low bits of 32
+#define DEPTH_FORMAT_UNORM24          1
+// 32-bit float reversed z, 1 at the near plane and 0 at the far plane
+#define DEPTH_FORMAT_FLOAT32_REVERSED 2
+#define DEPTH_FORMAT_NUM              3
+#define DEPTH_FORMAT_BYTES(format)    ((format) == DEPTH_FORMAT_UNORM16 ? 2 : 4)
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <chrono> // steady_clock
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
 #include <math.h> // sqrt
@@ -6,11 +7,26 @@
 #include <stdio.h>  // printf
 #include <stdlib.h> // malloc
 #include <string.h> // memset
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> // VirtualAlloc
+#elif defined(__linux__)
+#include <linux/perf_event.h> // --bench-memory
+#include <sys/ioctl.h>
+#include <sys/mman.h> // mmap
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 #include "renderer_ispc.h"
 #include "common.h"
 #define FAST_OBJ_IMPLEMENTATION
 #include "fast_obj.h"
 
+// tasksys.cpp
+int getTaskThreadCount();
+
 
 
 #define staticArrayLen(arr) (sizeof(arr) / sizeof(arr[0]))
@@ -227,19 +243,146 @@ struct Context {
     int frameSizeX;
     int frameSizeY;
     uint8_t* framebufferColor;
-    uint16_t* framebufferDepth;
+    // Row-major copy of the color for presentation, tiles nothing was drawn to only get cleared here
+    uint8_t* framebufferResolved;
+    int framebufferLayout;
+    uint8_t* framebufferDepth;
+    // DEPTH_FORMAT_*, fixed for the lifetime of the depth buffer
+    int depthFormat;
     Camera camera;
     Vec3 cameraEuler;
     Vec2 cursor;
     bool enableWriteframe;
+    int rasterMode;
+    int cullMode;
+    int shadingMode;
+    bool enableTileBuffers;
+    int occlusionMode;
+    // Back framebuffers and vertex storage with 2MB pages, see allocBuffer
+    bool enableHugePages;
+    bool enableIndexedGeometry;
+    // VERTEX_FORMAT_* of the model, -1 lets the loader choose
+    int vertexFormat;
 };
 
 static Context g_context = {};
 
+// Command line names of the DEPTH_FORMAT_* values
+static const char* g_depthFormatNames[DEPTH_FORMAT_NUM] = {"unorm16", "unorm24", "float32"};
+// Command line names of the VERTEX_FORMAT_* values
+static const char* g_vertexFormatNames[VERTEX_FORMAT_NUM] = {"float", "quantized16", "quantized8"};
+
+#define CACHE_LINE_SIZE 64
+#define HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+// In front of every allocBuffer allocation, the data starts one cache line after it
+struct BufferHeader {
+    // Size of the huge page mapping, 0 for a heap allocation
+    size_t mappedSize;
+};
+
+// Returns nullptr when the OS doesn't grant huge pages.
+static void* allocHugePages(const size_t size) {
+#if defined(_WIN32)
+    // Large pages need the "Lock pages in memory" privilege, which has to be assigned to the user and enabled here
+    static bool privilegeEnabled = false;
+    if(!privilegeEnabled) {
+        HANDLE token;
+        if(OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            TOKEN_PRIVILEGES privileges = {};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            if(LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)) {
+                AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr);
+            }
+            CloseHandle(token);
+        }
+        privilegeEnabled = true;
+    }
+    const size_t largePageSize = GetLargePageMinimum();
+    if(largePageSize == 0 || size % largePageSize != 0) return nullptr;
+    return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#elif defined(__linux__)
+    // Transparent huge pages, the mapping is trimmed so it starts on a huge page
+    uint8_t* mapped = (uint8_t*)mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapped == MAP_FAILED) return nullptr;
+    const size_t head = (HUGE_PAGE_SIZE - (uintptr_t)mapped % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+    if(head > 0) munmap(mapped, head);
+    munmap(mapped + head + size, HUGE_PAGE_SIZE - head);
+    madvise(mapped + head, size, MADV_HUGEPAGE);
+    return mapped + head;
+#else
+    return nullptr;
+#endif
+}
+
+// Cache line aligned storage for the framebuffers and the vertices. With Context.enableHugePages it is backed by huge
+// pages where the OS grants them, a 4K frame then needs a few dozen TLB entries instead of thousands.
+static void* allocBuffer(const size_t size) {
+    const size_t totalSize = (size + 2 * CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    BufferHeader header = {};
+    uint8_t* base = nullptr;
+    if(g_context.enableHugePages) {
+        header.mappedSize = (totalSize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        base = (uint8_t*)allocHugePages(header.mappedSize);
+        if(base == nullptr) header.mappedSize = 0;
+    }
+    if(base == nullptr) {
+#if defined(_MSC_VER)
+        base = (uint8_t*)_aligned_malloc(totalSize, CACHE_LINE_SIZE);
+#else
+        base = (uint8_t*)aligned_alloc(CACHE_LINE_SIZE, totalSize);
+#endif
+    }
+    assert(base != nullptr);
+    memcpy(base, &header, sizeof(header));
+    return base + CACHE_LINE_SIZE;
+}
+
+static void freeBuffer(void* ptr) {
+    if(ptr == nullptr) {
+        return;
+    }
+    uint8_t* base = (uint8_t*)ptr - CACHE_LINE_SIZE;
+    BufferHeader header;
+    memcpy(&header, base, sizeof(header));
+    if(header.mappedSize > 0) {
+#if defined(_WIN32)
+        VirtualFree(base, 0, MEM_RELEASE);
+#elif defined(__linux__)
+        munmap(base, header.mappedSize);
+#endif
+    } else {
+#if defined(_MSC_VER)
+        _aligned_free(base);
+#else
+        free(base);
+#endif
+    }
+}
+
 static size_t getFrameImageSizeInBytes() {
     return FRAMEBUFFER_COLOR_BYTES * g_context.frameSizeX * g_context.frameSizeY;
 }
 
+// Pixels allocated for the framebuffers, the frame rounded up to whole blocks
+static size_t getFramebufferPixelNum() {
+    return (size_t)FRAMEBUFFER_PADDED_SIZE(g_context.frameSizeX) * FRAMEBUFFER_PADDED_SIZE(g_context.frameSizeY);
+}
+
+static void createDepthBuffer() {
+    freeBuffer(g_context.framebufferDepth);
+    g_context.framebufferDepth = (uint8_t*)allocBuffer(DEPTH_FORMAT_BYTES(g_context.depthFormat) * getFramebufferPixelNum());
+}
+
+static void changeDepthFormat(const int depthFormat) {
+    if(depthFormat == g_context.depthFormat) {
+        return;
+    }
+    g_context.depthFormat = depthFormat;
+    createDepthBuffer();
+}
+
 static void changeFrameSize(const int x, const int y) {
     if(x <= 0 || y <= 0) {
         return;
@@ -249,13 +392,22 @@ static void changeFrameSize(const int x, const int y) {
     }
     g_context.frameSizeX = x;
     g_context.frameSizeY = y;
-    if(g_context.framebufferColor != nullptr) free(g_context.framebufferColor);
-    if(g_context.framebufferDepth != nullptr) free(g_context.framebufferDepth);
-    g_context.framebufferColor = (uint8_t*)malloc(getFrameImageSizeInBytes());
-    g_context.framebufferDepth =
-        (uint16_t*)malloc(FRAMEBUFFER_DEPTH_BYTES * g_context.frameSizeX * g_context.frameSizeY);
-    assert(g_context.framebufferColor != nullptr);
-    assert(g_context.framebufferDepth != nullptr);
+    freeBuffer(g_context.framebufferColor);
+    freeBuffer(g_context.framebufferResolved);
+    g_context.framebufferColor = (uint8_t*)allocBuffer(FRAMEBUFFER_COLOR_BYTES * getFramebufferPixelNum());
+    g_context.framebufferResolved = (uint8_t*)allocBuffer(getFrameImageSizeInBytes());
+    createDepthBuffer();
+}
+
+static void destroyFramebuffers() {
+    freeBuffer(g_context.framebufferColor);
+    freeBuffer(g_context.framebufferResolved);
+    freeBuffer(g_context.framebufferDepth);
+    g_context.framebufferColor = nullptr;
+    g_context.framebufferResolved = nullptr;
+    g_context.framebufferDepth = nullptr;
+    g_context.frameSizeX = 0;
+    g_context.frameSizeY = 0;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback
@@ -283,7 +435,7 @@ static void GLAPIENTRY debugMessageOpenglCallback(
         message);
 }
 
-static void uploadFrameImageToGpu(GLuint texture) {
+static void uploadFrameImageToGpu(GLuint texture, const uint8_t* pixels) {
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(
         GL_TEXTURE_2D,
@@ -294,7 +446,7 @@ static void uploadFrameImageToGpu(GLuint texture) {
         0,
         GL_RGBA,
         GL_UNSIGNED_BYTE,
-        g_context.framebufferColor);
+        pixels);
 }
 
 // View to screen matrix
@@ -359,6 +511,182 @@ size_t loadModel(
     return len;
 }
 
+// Like loadModel, but every distinct position and normal pair is stored once and the triangles index them, three
+// indices per triangle. Appends to both buffers, vertexBufferLen is updated and the new index buffer length returned.
+size_t loadModelIndexed(
+    const char* path,
+    float* vertexBuffer,
+    size_t* vertexBufferLen,
+    const size_t vertexBufferSize,
+    int32_t* indexBuffer,
+    const size_t indexBufferLen,
+    const size_t indexBufferSize,
+    const Vec3 offset = {},
+    const float scale = 1.0f) {
+    fastObjMesh* mesh = fast_obj_read(path);
+    assert(mesh);
+    // Vertices created so far for each position, chained through vertexNext, so the one with the same normal is found
+    int32_t* positionVertices = (int32_t*)malloc(mesh->position_count * sizeof(int32_t));
+    int32_t* vertexNext = (int32_t*)malloc(mesh->index_count * sizeof(int32_t));
+    unsigned int* vertexNormals = (unsigned int*)malloc(mesh->index_count * sizeof(unsigned int));
+    assert(positionVertices != nullptr && vertexNext != nullptr && vertexNormals != nullptr);
+    for(unsigned int i = 0; i < mesh->position_count; i++) positionVertices[i] = -1;
+    const int32_t baseVertex = (int32_t)(*vertexBufferLen / VERTEX_FLOATS);
+    int32_t vertexNum = 0;
+    size_t len = indexBufferLen;
+    for(unsigned int ii = 0; ii < mesh->group_count; ii++) {
+        const fastObjGroup& grp = mesh->groups[ii];
+        int idx = 0;
+        for(unsigned int jj = 0; jj < grp.face_count; jj++) {
+            unsigned int fv = mesh->face_vertices[grp.face_offset + jj];
+            for(unsigned int kk = 0; kk < fv; kk++) {
+                fastObjIndex mi = mesh->indices[grp.index_offset + idx];
+                if(mi.p) {
+                    int32_t vertex = positionVertices[mi.p];
+                    while(vertex >= 0 && vertexNormals[vertex] != mi.n) vertex = vertexNext[vertex];
+                    if(vertex < 0) {
+                        vertex = vertexNum++;
+                        vertexNext[vertex] = positionVertices[mi.p];
+                        vertexNormals[vertex] = mi.n;
+                        positionVertices[mi.p] = vertex;
+                        float* dst = &vertexBuffer[*vertexBufferLen];
+                        dst[0] = offset.elems[0] + mesh->positions[3 * mi.p + 0] * scale;
+                        dst[1] = offset.elems[1] + mesh->positions[3 * mi.p + 1] * scale;
+                        dst[2] = offset.elems[2] + mesh->positions[3 * mi.p + 2] * scale;
+                        dst[3] = mesh->normals[3 * mi.n + 0];
+                        dst[4] = mesh->normals[3 * mi.n + 1];
+                        dst[5] = mesh->normals[3 * mi.n + 2];
+                        *vertexBufferLen += VERTEX_FLOATS;
+                        assert(*vertexBufferLen < vertexBufferSize);
+                    }
+                    indexBuffer[len] = baseVertex + vertex;
+                    len++;
+                    assert(len < indexBufferSize);
+                }
+                idx++;
+            }
+        }
+    }
+    free(vertexNormals);
+    free(vertexNext);
+    free(positionVertices);
+    fast_obj_destroy(mesh);
+    return len;
+}
+
+// Copies indexed triangles out to a triangle list as loadModel makes it, returns its length.
+size_t expandIndexedTriangles(const float* vertexBuffer, const int32_t* indexBuffer, const size_t indexBufferLen, float* triangleList) {
+    for(size_t i = 0; i < indexBufferLen; i++) {
+        memcpy(&triangleList[i * VERTEX_FLOATS], &vertexBuffer[indexBuffer[i] * VERTEX_FLOATS], VERTEX_FLOATS * sizeof(float));
+    }
+    return indexBufferLen * VERTEX_FLOATS;
+}
+
+// Bounding box of every CLUSTER_TRIANGLES consecutive triangles, for occlusion culling. The triangles index the
+// vertices through indexBuffer, or are a triangle list when it is nullptr.
+// returns the number of clusters
+size_t computeClusterBounds(const float* vertexBuffer, const int32_t* indexBuffer, const size_t triangleNum, float* clusterBounds) {
+    const size_t clusterNum = (triangleNum + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES;
+    for(size_t cluster = 0; cluster < clusterNum; cluster++) {
+        float* bounds = &clusterBounds[cluster * CLUSTER_BOUNDS_FLOATS];
+        const size_t cornerBegin = cluster * CLUSTER_TRIANGLES * 3;
+        const size_t cornerEnd = cornerBegin + CLUSTER_TRIANGLES * 3 < triangleNum * 3 ? cornerBegin + CLUSTER_TRIANGLES * 3 : triangleNum * 3;
+        const size_t firstVertex = indexBuffer != nullptr ? indexBuffer[cornerBegin] : cornerBegin;
+        for(int e = 0; e < 3; e++) {
+            bounds[e] = vertexBuffer[firstVertex * VERTEX_FLOATS + e];
+            bounds[3 + e] = bounds[e];
+        }
+        for(size_t corner = cornerBegin; corner < cornerEnd; corner++) {
+            const size_t vertex = indexBuffer != nullptr ? indexBuffer[corner] : corner;
+            for(int e = 0; e < 3; e++) {
+                const float value = vertexBuffer[vertex * VERTEX_FLOATS + e];
+                if(value < bounds[e]) bounds[e] = value;
+                if(value > bounds[3 + e]) bounds[3 + e] = value;
+            }
+        }
+    }
+    return clusterNum;
+}
+
+
+// Meshes with fewer vertices aren't limited by the bandwidth of their vertices and stay in VERTEX_FORMAT_FLOAT
+#define VERTEX_QUANTIZE_MIN_VERTICES (64 * 1024)
+
+// The format the loader picks for a mesh: 16-bit positions and normals once it is big enough. QUANTIZED8 normals shade
+// visibly coarser, they are only used when asked for.
+static int chooseVertexFormat(const size_t vertexNum) {
+    return vertexNum >= VERTEX_QUANTIZE_MIN_VERTICES ? VERTEX_FORMAT_QUANTIZED16 : VERTEX_FORMAT_FLOAT;
+}
+
+// Octahedral mapping of a unit vector to [-1, 1]^2, the lower half is folded over the diagonals
+static void encodeOctahedral(const float* normal, float* u, float* v) {
+    const float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    const float x = sum > 0.0f ? normal[0] / sum : 0.0f;
+    const float y = sum > 0.0f ? normal[1] / sum : 0.0f;
+    if(normal[2] >= 0.0f) {
+        *u = x;
+        *v = y;
+    } else {
+        *u = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        *v = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+}
+
+static int16_t encodeSnorm(const float value, const float maxValue) {
+    const float clamped = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int16_t)lroundf(clamped * maxValue);
+}
+
+// Packs VERTEX_FLOATS vertices into one of the quantized VERTEX_FORMAT_*, positions relative to their bounding box.
+// Returns the number of 16-bit values written.
+static size_t quantizeVertices(
+    const float* vertexBuffer,
+    const size_t vertexBufferLen,
+    const int format,
+    uint16_t* packed,
+    Vec3* positionMin,
+    Vec3* positionScale) {
+    Vec3 boundsMin = {vertexBuffer[0], vertexBuffer[1], vertexBuffer[2]};
+    Vec3 boundsMax = boundsMin;
+    for(size_t i = 0; i < vertexBufferLen; i += VERTEX_FLOATS) {
+        for(int e = 0; e < 3; e++) {
+            if(vertexBuffer[i + e] < boundsMin.elems[e]) boundsMin.elems[e] = vertexBuffer[i + e];
+            if(vertexBuffer[i + e] > boundsMax.elems[e]) boundsMax.elems[e] = vertexBuffer[i + e];
+        }
+    }
+    *positionMin = boundsMin;
+    for(int e = 0; e < 3; e++) positionScale->elems[e] = (boundsMax.elems[e] - boundsMin.elems[e]) / 65535.0f;
+
+    const size_t stride = VERTEX_FORMAT_SHORTS(format);
+    size_t len = 0;
+    for(size_t i = 0; i < vertexBufferLen; i += VERTEX_FLOATS) {
+        uint16_t* dst = &packed[len];
+        for(int e = 0; e < 3; e++) {
+            const float scale = positionScale->elems[e];
+            dst[e] = scale > 0.0f ? (uint16_t)lroundf((vertexBuffer[i + e] - boundsMin.elems[e]) / scale) : 0;
+        }
+        float u, v;
+        encodeOctahedral(&vertexBuffer[i + 3], &u, &v);
+        if(format == VERTEX_FORMAT_QUANTIZED16) {
+            dst[3] = (uint16_t)encodeSnorm(u, 32767.0f);
+            dst[4] = (uint16_t)encodeSnorm(v, 32767.0f);
+        } else {
+            dst[3] = (uint16_t)((uint8_t)encodeSnorm(u, 127.0f) | ((uint8_t)encodeSnorm(v, 127.0f) << 8));
+        }
+        len += stride;
+    }
+    return len;
+}
+
+// Quantized positions round to the nearest step, widens the bounds by a step so they still contain the triangles.
+static void padClusterBounds(float* clusterBounds, const size_t clusterNum, const Vec3 positionScale) {
+    for(size_t cluster = 0; cluster < clusterNum; cluster++) {
+        for(int e = 0; e < 3; e++) {
+            clusterBounds[cluster * CLUSTER_BOUNDS_FLOATS + e] -= positionScale.elems[e];
+            clusterBounds[cluster * CLUSTER_BOUNDS_FLOATS + 3 + e] += positionScale.elems[e];
+        }
+    }
+}
 
 
 // process all input: query GLFW whether relevant keys are pressed/released this
@@ -396,6 +724,35 @@ static void processInput(GLFWwindow* window, const float deltaTime) {
     g_context.enableWriteframe = false;
     if(glfwGetKey(window, GLFW_KEY_V)) g_context.enableWriteframe = true;
 
+    // Raster mode, the old row by row raster for comparison
+    g_context.rasterMode = RASTER_MODE_FOOTPRINT;
+    if(glfwGetKey(window, GLFW_KEY_F)) g_context.rasterMode = RASTER_MODE_ROWS;
+
+    // Culling, back faces by default
+    g_context.cullMode = CULL_MODE_BACK;
+    if(glfwGetKey(window, GLFW_KEY_B)) g_context.cullMode = CULL_MODE_NONE;
+    if(glfwGetKey(window, GLFW_KEY_N)) g_context.cullMode = CULL_MODE_FRONT;
+
+    // Shading, deferred through the visibility buffer while G is held, with a depth pre-pass while P is held
+    g_context.shadingMode = SHADING_MODE_FORWARD;
+    if(glfwGetKey(window, GLFW_KEY_G)) g_context.shadingMode = SHADING_MODE_DEFERRED;
+    if(glfwGetKey(window, GLFW_KEY_P)) g_context.shadingMode = SHADING_MODE_DEPTH_PREPASS;
+
+    // Framebuffer in 8x8 blocks, row-major while M is held
+    g_context.framebufferLayout = FRAMEBUFFER_LAYOUT_BLOCKS;
+    if(glfwGetKey(window, GLFW_KEY_M)) g_context.framebufferLayout = FRAMEBUFFER_LAYOUT_LINEAR;
+
+    // Tiles render into local buffers which are written back once, straight into the framebuffer while L is held
+    g_context.enableTileBuffers = !glfwGetKey(window, GLFW_KEY_L);
+
+    // Indexed geometry, the triangle list with three vertices per triangle while X is held
+    g_context.enableIndexedGeometry = !glfwGetKey(window, GLFW_KEY_X);
+
+    // Occlusion culling of triangle clusters, temporal by default, with an occluder pass while T is held, off while O is held
+    g_context.occlusionMode = OCCLUSION_MODE_TEMPORAL;
+    if(glfwGetKey(window, GLFW_KEY_T)) g_context.occlusionMode = OCCLUSION_MODE_OCCLUDERS;
+    if(glfwGetKey(window, GLFW_KEY_O)) g_context.occlusionMode = OCCLUSION_MODE_NONE;
+
     // Zoom
     if(glfwGetKey(window, GLFW_KEY_C)) g_context.camera.fieldOfView -= 60.0f * deltaTime;
     if(glfwGetKey(window, GLFW_KEY_Z)) g_context.camera.fieldOfView += 60.0f * deltaTime;
@@ -410,8 +767,533 @@ static void processInput(GLFWwindow* window, const float deltaTime) {
 
 
 
+// Bounding sphere around the box of all vertex positions
+static void calcModelBoundingSphere(const float* vertexBuffer, const size_t vertexBufferLen, Vec3* center, float* radius) {
+    Vec3 boundsMin = {vertexBuffer[0], vertexBuffer[1], vertexBuffer[2]};
+    Vec3 boundsMax = boundsMin;
+    for(size_t i = 0; i < vertexBufferLen; i += VERTEX_FLOATS) {
+        for(int e = 0; e < 3; e++) {
+            if(vertexBuffer[i + e] < boundsMin.elems[e]) boundsMin.elems[e] = vertexBuffer[i + e];
+            if(vertexBuffer[i + e] > boundsMax.elems[e]) boundsMax.elems[e] = vertexBuffer[i + e];
+        }
+    }
+    *center = vec3MulF(vec3Add(boundsMin, boundsMax), 0.5f);
+    const Vec3 extent = vec3Add(boundsMax, vec3MulF(boundsMin, -1.0f));
+    *radius = 0.5f * sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+}
+
+// Headless check of the fill convention: renders the bundled models from a few views with the coverage debug buffer
+// and counts pixels covered by two triangles which share an edge. With the top-left rule there must be none. Every
+// raster mode, framebuffer layout, tile buffer setting and shading mode is checked, they write pixels on their own
+// paths. Returns the process exit code.
+static int runFillVerification() {
+    const char* modelPaths[] = {"models/cube.obj", "models/teapot.obj", "models/bunny.obj", "models/swordfish.obj"};
+    const Vec3 viewEulers[] = {{0.0f, 0.0f, 0.0f}, {-0.5f, 0.8f, 0.0f}, {0.3f, -2.4f, 0.0f}};
+    const char* shadingModeNames[] = {"forward", "deferred", "prepass"};
+    // Raster mode, framebuffer layout, tile buffers and shading mode of each configuration
+    const int configNum = 2 * 2 * 2 * staticArrayLen(shadingModeNames);
+    const size_t vertexBufferSize = 1024 * 1024 * 20;
+    float* vertexBuffer = (float*)allocBuffer(vertexBufferSize * sizeof(float));
+    changeFrameSize(800, 600);
+    const size_t pixelNum = (size_t)g_context.frameSizeX * g_context.frameSizeY;
+    int32_t* coverage = (int32_t*)malloc(pixelNum * COVERAGE_PIXEL_INTS * sizeof(int32_t));
+    assert(coverage != nullptr);
+
+    int failNum = 0;
+    for(size_t modelIndex = 0; modelIndex < staticArrayLen(modelPaths); modelIndex++) {
+        const size_t vertexBufferLen = loadModel(modelPaths[modelIndex], vertexBuffer, 0, vertexBufferSize);
+
+        // Frame the model's bounding sphere
+        Vec3 center;
+        float radius;
+        calcModelBoundingSphere(vertexBuffer, vertexBufferLen, &center, &radius);
+
+        for(size_t viewIndex = 0; viewIndex < staticArrayLen(viewEulers); viewIndex++) {
+            for(int config = 0; config < configNum; config++) {
+                const int rasterMode = config % 2 == 0 ? RASTER_MODE_ROWS : RASTER_MODE_FOOTPRINT;
+                const int framebufferLayout = config / 2 % 2 == 0 ? FRAMEBUFFER_LAYOUT_LINEAR : FRAMEBUFFER_LAYOUT_BLOCKS;
+                const bool enableTileBuffers = config / 4 % 2 == 1;
+                const int shadingMode = config / 8;
+                g_context.camera.rot = quatFromEuler(viewEulers[viewIndex]);
+                g_context.camera.pos = vec3Add(center, quatMulVec3(g_context.camera.rot, {0.0f, 0.0f, radius * 1.8f}));
+                g_context.camera.nearPlane = radius * 0.01f;
+                const Mat4 transformMat4 = calcCameraMatrix(g_context.camera);
+
+                memset(coverage, 0, pixelNum * COVERAGE_PIXEL_INTS * sizeof(int32_t));
+                ispc::RenderFrameParams params = {
+                    .framebufferColor = g_context.framebufferColor,
+                    .framebufferLayout = framebufferLayout,
+                    .framebufferDepth = g_context.framebufferDepth,
+                    .depthFormat = g_context.depthFormat,
+                    .frameSizeX = g_context.frameSizeX,
+                    .frameSizeY = g_context.frameSizeY,
+                    .pointData = vertexBuffer,
+                    .pointNum = (int32_t)vertexBufferLen,
+                    .camera = {g_context.camera.pos.x, g_context.camera.pos.y, g_context.camera.pos.z},
+                    .nearPlane = g_context.camera.nearPlane,
+                    .farPlane = g_context.camera.farPlane,
+                    .enableWireframe = false,
+                    .rasterMode = rasterMode,
+                    .cullMode = CULL_MODE_BACK,
+                    .shadingMode = shadingMode,
+                    .enableTileBuffers = enableTileBuffers,
+                    .coverage = coverage,
+                    .threadNum = getTaskThreadCount(),
+                };
+                memcpy(params.transformMat4, transformMat4.elems, sizeof(params.transformMat4));
+                ispc::renderFrame(&params);
+
+                int coveredNum = 0;
+                int doubleHitNum = 0;
+                for(size_t pixel = 0; pixel < pixelNum; pixel++) {
+                    const int32_t* hits = &coverage[pixel * COVERAGE_PIXEL_INTS];
+                    const int hitNum = hits[0] < COVERAGE_PIXEL_INTS - 1 ? hits[0] : COVERAGE_PIXEL_INTS - 1;
+                    if(hitNum > 0) coveredNum++;
+                    bool doubleHit = false;
+                    for(int i = 1; i <= hitNum && !doubleHit; i++) {
+                        for(int j = i + 1; j <= hitNum && !doubleHit; j++) {
+                            // Triangles share an edge if two of their vertex positions are equal
+                            int sharedNum = 0;
+                            for(int vi = 0; vi < 3; vi++) {
+                                const float* a = &vertexBuffer[(hits[i] * 3 + vi) * VERTEX_FLOATS];
+                                for(int vj = 0; vj < 3; vj++) {
+                                    const float* b = &vertexBuffer[(hits[j] * 3 + vj) * VERTEX_FLOATS];
+                                    if(a[0] == b[0] && a[1] == b[1] && a[2] == b[2]) sharedNum++;
+                                }
+                            }
+                            doubleHit = sharedNum == 2;
+                        }
+                    }
+                    if(doubleHit) doubleHitNum++;
+                }
+
+                printf(
+                    "verify-fill %s view:%i mode:%s layout:%s tile buffers:%i shading:%s covered:%i double hits:%i\n",
+                    modelPaths[modelIndex],
+                    (int)viewIndex,
+                    rasterMode == RASTER_MODE_ROWS ? "rows" : "footprint",
+                    framebufferLayout == FRAMEBUFFER_LAYOUT_LINEAR ? "linear" : "blocks",
+                    (int)enableTileBuffers,
+                    shadingModeNames[shadingMode],
+                    coveredNum,
+                    doubleHitNum);
+                if(doubleHitNum > 0 || coveredNum == 0) failNum++;
+            }
+        }
+    }
+
+    free(coverage);
+    freeBuffer(vertexBuffer);
+    printf("verify-fill %s\n", failNum == 0 ? "passed" : "FAILED");
+    return failNum == 0 ? 0 : 1;
+}
+
+
+// Headless comparison of the depth formats: renders the bundled models close up and from far away with the default
+// near and far planes, and prints the frame time, the depth buffer size and the pixels which come out different than
+// with DEPTH_FORMAT_FLOAT32_REVERSED. Each format is also rendered with SHADING_MODE_DEPTH_PREPASS, whose equal depth
+// pass relies on conservative depth bounds, and the pixels it leaves at the clear color where the forward frame has a
+// surface are printed as holes. Also prints the smallest view space depth difference each format can resolve at
+// a few distances. Returns the process exit code.
+static int runDepthBenchmark() {
+    const char* modelPaths[] = {"models/teapot.obj", "models/bunny.obj", "models/swordfish.obj"};
+    // Camera distances in bounding sphere radii
+    const float viewDistances[] = {1.8f, 40.0f};
+    const int frameNum = 32;
+    const size_t vertexBufferSize = 1024 * 1024 * 20;
+    float* vertexBuffer = (float*)allocBuffer(vertexBufferSize * sizeof(float));
+    changeFrameSize(1280, 720);
+    const size_t pixelNum = (size_t)g_context.frameSizeX * g_context.frameSizeY;
+    uint8_t* referenceColor = (uint8_t*)malloc(pixelNum * FRAMEBUFFER_COLOR_BYTES);
+    uint8_t* forwardColor = (uint8_t*)malloc(pixelNum * FRAMEBUFFER_COLOR_BYTES);
+    assert(referenceColor != nullptr && forwardColor != nullptr);
+
+    const Camera defaultCamera = {};
+    const float n = defaultCamera.nearPlane;
+    const float f = defaultCamera.farPlane;
+    const float distances[] = {1.0f, 10.0f, 100.0f, 500.0f};
+    for(int format = 0; format < DEPTH_FORMAT_NUM; format++) {
+        printf("bench-depth format:%s bytes/px:%i resolution:", g_depthFormatNames[format], DEPTH_FORMAT_BYTES(format));
+        for(size_t i = 0; i < staticArrayLen(distances); i++) {
+            // Stored value per view space depth, and the size of one step of the stored value there
+            const float w = distances[i];
+            const float slope = n * f / ((f - n) * w * w);
+            float step = 1.0f / 65535.0f;
+            if(format == DEPTH_FORMAT_UNORM24) step = 1.0f / 16777215.0f;
+            if(format == DEPTH_FORMAT_FLOAT32_REVERSED) {
+                const float value = n * f / ((f - n) * w) - n / (f - n);
+                step = nextafterf(value, 1.0f) - value;
+            }
+            printf(" %g@%g", step / slope, w);
+        }
+        printf("\n");
+    }
+
+    for(size_t modelIndex = 0; modelIndex < staticArrayLen(modelPaths); modelIndex++) {
+        const size_t vertexBufferLen = loadModel(modelPaths[modelIndex], vertexBuffer, 0, vertexBufferSize);
+        Vec3 center;
+        float radius;
+        calcModelBoundingSphere(vertexBuffer, vertexBufferLen, &center, &radius);
+
+        for(size_t viewIndex = 0; viewIndex < staticArrayLen(viewDistances); viewIndex++) {
+            g_context.camera = defaultCamera;
+            g_context.camera.rot = quatFromEuler({-0.5f, 0.8f, 0.0f});
+            g_context.camera.pos =
+                vec3Add(center, quatMulVec3(g_context.camera.rot, {0.0f, 0.0f, radius * viewDistances[viewIndex]}));
+            const Mat4 transformMat4 = calcCameraMatrix(g_context.camera);
+
+            // The reference goes first
+            for(int format = DEPTH_FORMAT_NUM - 1; format >= 0; format--) {
+                changeDepthFormat(format);
+                ispc::RenderFrameParams params = {
+                    .framebufferColor = g_context.framebufferColor,
+                    .framebufferDepth = g_context.framebufferDepth,
+                    .depthFormat = g_context.depthFormat,
+                    .frameSizeX = g_context.frameSizeX,
+                    .frameSizeY = g_context.frameSizeY,
+                    .pointData = vertexBuffer,
+                    .pointNum = (int32_t)vertexBufferLen,
+                    .camera = {g_context.camera.pos.x, g_context.camera.pos.y, g_context.camera.pos.z},
+                    .nearPlane = g_context.camera.nearPlane,
+                    .farPlane = g_context.camera.farPlane,
+                    .enableWireframe = false,
+                    .rasterMode = RASTER_MODE_FOOTPRINT,
+                    .cullMode = CULL_MODE_BACK,
+                    .shadingMode = SHADING_MODE_FORWARD,
+                    .enableTileBuffers = true,
+                    .threadNum = getTaskThreadCount(),
+                };
+                memcpy(params.transformMat4, transformMat4.elems, sizeof(params.transformMat4));
+
+                // Warm up the scratch buffers and tile costs
+                ispc::renderFrame(&params);
+                const auto begin = std::chrono::steady_clock::now();
+                for(int frame = 0; frame < frameNum; frame++) ispc::renderFrame(&params);
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+                ispc::resolveFramebuffer(&params, g_context.framebufferResolved);
+                if(format == DEPTH_FORMAT_FLOAT32_REVERSED) {
+                    memcpy(referenceColor, g_context.framebufferResolved, pixelNum * FRAMEBUFFER_COLOR_BYTES);
+                }
+                int differentNum = 0;
+                for(size_t pixel = 0; pixel < pixelNum; pixel++) {
+                    const uint8_t* a = &referenceColor[pixel * FRAMEBUFFER_COLOR_BYTES];
+                    const uint8_t* b = &g_context.framebufferResolved[pixel * FRAMEBUFFER_COLOR_BYTES];
+                    if(a[0] != b[0] || a[1] != b[1] || a[2] != b[2]) differentNum++;
+                }
+
+                memcpy(forwardColor, g_context.framebufferResolved, pixelNum * FRAMEBUFFER_COLOR_BYTES);
+                params.shadingMode = SHADING_MODE_DEPTH_PREPASS;
+                ispc::renderFrame(&params);
+                ispc::resolveFramebuffer(&params, g_context.framebufferResolved);
+                int holeNum = 0;
+                for(size_t pixel = 0; pixel < pixelNum; pixel++) {
+                    uint32_t a, b;
+                    memcpy(&a, &forwardColor[pixel * FRAMEBUFFER_COLOR_BYTES], sizeof(a));
+                    memcpy(&b, &g_context.framebufferResolved[pixel * FRAMEBUFFER_COLOR_BYTES], sizeof(b));
+                    if(b == CLEAR_COLOR && a != CLEAR_COLOR) holeNum++;
+                }
+
+                printf(
+                    "bench-depth %s distance:%g format:%s frame:%.3fms depth buffer:%iKB different:%ipx prepass holes:%ipx\n",
+                    modelPaths[modelIndex],
+                    radius * viewDistances[viewIndex],
+                    g_depthFormatNames[format],
+                    elapsed.count() / frameNum,
+                    (int)(pixelNum * DEPTH_FORMAT_BYTES(format) / 1024),
+                    differentNum,
+                    holeNum);
+            }
+        }
+    }
+
+    free(forwardColor);
+    free(referenceColor);
+    freeBuffer(vertexBuffer);
+    return 0;
+}
+
+
+// Headless comparison of the vertex formats: renders the bundled models as indexed geometry in every format and prints
+// the geometry bytes per triangle, the frame time and the pixels which come out different than with
+// VERTEX_FORMAT_FLOAT. Returns the process exit code.
+static int runVertexBenchmark() {
+    const char* modelPaths[] = {"models/teapot.obj", "models/bunny.obj", "models/swordfish.obj"};
+    const int frameNum = 32;
+    const size_t vertexBufferSize = 1024 * 1024 * 20;
+    const size_t indexBufferSize = 1024 * 1024 * 10;
+    float* vertexBuffer = (float*)allocBuffer(vertexBufferSize * sizeof(float));
+    int32_t* indexBuffer = (int32_t*)allocBuffer(indexBufferSize * sizeof(int32_t));
+    uint16_t* packedVertexBuffer = (uint16_t*)allocBuffer(vertexBufferSize / VERTEX_FLOATS * VERTEX_FORMAT_BYTES(VERTEX_FORMAT_QUANTIZED16));
+    changeFrameSize(1280, 720);
+    const size_t pixelNum = (size_t)g_context.frameSizeX * g_context.frameSizeY;
+    uint8_t* referenceColor = (uint8_t*)malloc(pixelNum * FRAMEBUFFER_COLOR_BYTES);
+    assert(referenceColor != nullptr);
+
+    for(size_t modelIndex = 0; modelIndex < staticArrayLen(modelPaths); modelIndex++) {
+        size_t vertexBufferLen = 0;
+        const size_t indexBufferLen =
+            loadModelIndexed(modelPaths[modelIndex], vertexBuffer, &vertexBufferLen, vertexBufferSize, indexBuffer, 0, indexBufferSize);
+        const size_t vertexNum = vertexBufferLen / VERTEX_FLOATS;
+        const size_t triangleNum = indexBufferLen / 3;
+        Vec3 center;
+        float radius;
+        calcModelBoundingSphere(vertexBuffer, vertexBufferLen, &center, &radius);
+
+        g_context.camera = {};
+        g_context.camera.rot = quatFromEuler({-0.5f, 0.8f, 0.0f});
+        g_context.camera.pos = vec3Add(center, quatMulVec3(g_context.camera.rot, {0.0f, 0.0f, radius * 1.8f}));
+        const Mat4 transformMat4 = calcCameraMatrix(g_context.camera);
+
+        // The reference goes first
+        for(int format = 0; format < VERTEX_FORMAT_NUM; format++) {
+            size_t packedVertexBufferLen = 0;
+            Vec3 positionMin = {};
+            Vec3 positionScale = {};
+            if(format != VERTEX_FORMAT_FLOAT) {
+                packedVertexBufferLen =
+                    quantizeVertices(vertexBuffer, vertexBufferLen, format, packedVertexBuffer, &positionMin, &positionScale);
+            }
+            ispc::RenderFrameParams params = {
+                .framebufferColor = g_context.framebufferColor,
+                .framebufferDepth = g_context.framebufferDepth,
+                .depthFormat = g_context.depthFormat,
+                .frameSizeX = g_context.frameSizeX,
+                .frameSizeY = g_context.frameSizeY,
+                .pointData = vertexBuffer,
+                .pointNum = (int32_t)(format == VERTEX_FORMAT_FLOAT ? vertexBufferLen : packedVertexBufferLen),
+                .indexData = indexBuffer,
+                .indexNum = (int32_t)indexBufferLen,
+                .vertexFormat = format,
+                .packedPointData = packedVertexBuffer,
+                .positionMin = {positionMin.x, positionMin.y, positionMin.z},
+                .positionScale = {positionScale.x, positionScale.y, positionScale.z},
+                .camera = {g_context.camera.pos.x, g_context.camera.pos.y, g_context.camera.pos.z},
+                .nearPlane = g_context.camera.nearPlane,
+                .farPlane = g_context.camera.farPlane,
+                .enableWireframe = false,
+                .rasterMode = RASTER_MODE_FOOTPRINT,
+                .cullMode = CULL_MODE_BACK,
+                .shadingMode = SHADING_MODE_FORWARD,
+                .enableTileBuffers = true,
+                .threadNum = getTaskThreadCount(),
+            };
+            memcpy(params.transformMat4, transformMat4.elems, sizeof(params.transformMat4));
+
+            // Warm up the scratch buffers and tile costs
+            ispc::renderFrame(&params);
+            const auto begin = std::chrono::steady_clock::now();
+            for(int frame = 0; frame < frameNum; frame++) ispc::renderFrame(&params);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+            ispc::resolveFramebuffer(&params, g_context.framebufferResolved);
+            if(format == VERTEX_FORMAT_FLOAT) {
+                memcpy(referenceColor, g_context.framebufferResolved, pixelNum * FRAMEBUFFER_COLOR_BYTES);
+            }
+            int differentNum = 0;
+            for(size_t pixel = 0; pixel < pixelNum; pixel++) {
+                const uint8_t* a = &referenceColor[pixel * FRAMEBUFFER_COLOR_BYTES];
+                const uint8_t* b = &g_context.framebufferResolved[pixel * FRAMEBUFFER_COLOR_BYTES];
+                if(a[0] != b[0] || a[1] != b[1] || a[2] != b[2]) differentNum++;
+            }
+
+            const size_t geometryBytes = vertexNum * VERTEX_FORMAT_BYTES(format) + indexBufferLen * sizeof(int32_t);
+            printf(
+                "bench-vertex %s format:%s vertex:%iB geometry:%.1fB/tri frame:%.3fms different:%ipx\n",
+                modelPaths[modelIndex],
+                g_vertexFormatNames[format],
+                VERTEX_FORMAT_BYTES(format),
+                (double)geometryBytes / triangleNum,
+                elapsed.count() / frameNum,
+                differentNum);
+        }
+    }
+
+    free(referenceColor);
+    freeBuffer(packedVertexBuffer);
+    freeBuffer(indexBuffer);
+    freeBuffer(vertexBuffer);
+    return 0;
+}
+
+
+#define MEMORY_BENCHMARK_FRAMES 32
+
+#if defined(__linux__)
+// Pipes between the process rendering a --bench-memory configuration and the one counting its TLB misses
+static int g_benchToParent[2];
+static int g_benchToChild[2];
+
+static void waitForBenchChild() {
+    char byte;
+    if(read(g_benchToParent[0], &byte, 1) != 1) byte = 0;
+}
+
+static void resumeBenchChild() {
+    const char byte = 0;
+    if(write(g_benchToChild[1], &byte, 1) != 1) return;
+}
+
+// Runs in the child, blocks until the parent has started or stopped counting.
+static void syncWithBenchParent() {
+    char byte = 0;
+    if(write(g_benchToParent[1], &byte, 1) != 1) return;
+    if(read(g_benchToChild[0], &byte, 1) != 1) return;
+}
+#endif
+
+// Renders the swordfish at 4K and prints the render and resolve time per frame. syncMeasure is called right before
+// and after the measured frames, or not at all when it is nullptr.
+static void renderMemoryBenchmark(const bool hugePages, void (*syncMeasure)()) {
+    const int frameNum = MEMORY_BENCHMARK_FRAMES;
+    g_context.enableHugePages = hugePages;
+    const size_t vertexBufferSize = 1024 * 1024 * 20;
+    float* vertexBuffer = (float*)allocBuffer(vertexBufferSize * sizeof(float));
+    changeFrameSize(3840, 2160);
+    const size_t vertexBufferLen = loadModel("models/swordfish.obj", vertexBuffer, 0, vertexBufferSize);
+    Vec3 center;
+    float radius;
+    calcModelBoundingSphere(vertexBuffer, vertexBufferLen, &center, &radius);
+
+    g_context.camera = {};
+    g_context.camera.rot = quatFromEuler({-0.5f, 0.8f, 0.0f});
+    g_context.camera.pos = vec3Add(center, quatMulVec3(g_context.camera.rot, {0.0f, 0.0f, radius * 1.8f}));
+    const Mat4 transformMat4 = calcCameraMatrix(g_context.camera);
+    ispc::RenderFrameParams params = {
+        .framebufferColor = g_context.framebufferColor,
+        .framebufferLayout = FRAMEBUFFER_LAYOUT_BLOCKS,
+        .framebufferDepth = g_context.framebufferDepth,
+        .depthFormat = g_context.depthFormat,
+        .frameSizeX = g_context.frameSizeX,
+        .frameSizeY = g_context.frameSizeY,
+        .pointData = vertexBuffer,
+        .pointNum = (int32_t)vertexBufferLen,
+        .camera = {g_context.camera.pos.x, g_context.camera.pos.y, g_context.camera.pos.z},
+        .nearPlane = g_context.camera.nearPlane,
+        .farPlane = g_context.camera.farPlane,
+        .enableWireframe = false,
+        .rasterMode = RASTER_MODE_FOOTPRINT,
+        .cullMode = CULL_MODE_BACK,
+        .shadingMode = SHADING_MODE_FORWARD,
+        .enableTileBuffers = true,
+        .threadNum = getTaskThreadCount(),
+    };
+    memcpy(params.transformMat4, transformMat4.elems, sizeof(params.transformMat4));
+
+    // Warm up the scratch buffers and tile costs
+    ispc::renderFrame(&params);
+    ispc::resolveFramebuffer(&params, g_context.framebufferResolved);
+    if(syncMeasure != nullptr) syncMeasure();
+    std::chrono::duration<double, std::milli> renderTime(0.0);
+    std::chrono::duration<double, std::milli> resolveTime(0.0);
+    for(int frame = 0; frame < frameNum; frame++) {
+        const auto begin = std::chrono::steady_clock::now();
+        ispc::renderFrame(&params);
+        const auto resolveBegin = std::chrono::steady_clock::now();
+        ispc::resolveFramebuffer(&params, g_context.framebufferResolved);
+        renderTime += resolveBegin - begin;
+        resolveTime += std::chrono::steady_clock::now() - resolveBegin;
+    }
+    if(syncMeasure != nullptr) syncMeasure();
+
+    printf(
+        "bench-memory huge pages:%s render:%.3fms resolve:%.3fms",
+        hugePages ? "on" : "off",
+        renderTime.count() / frameNum,
+        resolveTime.count() / frameNum);
+    fflush(stdout);
+    destroyFramebuffers();
+    freeBuffer(vertexBuffer);
+}
+
+// Headless comparison of 4K pages and huge pages for the framebuffers and vertices at 4K resolution. On Linux every
+// configuration renders in a child process, whose data TLB load misses are counted over the measured frames, including
+// the task system's threads. Elsewhere only the times are printed. Returns the process exit code.
+static int runMemoryBenchmark() {
+    for(int hugePages = 0; hugePages < 2; hugePages++) {
+#if defined(__linux__)
+        if(pipe(g_benchToParent) != 0 || pipe(g_benchToChild) != 0) return 1;
+        fflush(stdout);
+        const pid_t child = fork();
+        if(child == 0) {
+            // Start once the counter is attached, so it follows the threads the task system creates
+            char byte;
+            if(read(g_benchToChild[0], &byte, 1) != 1) _exit(1);
+            renderMemoryBenchmark(hugePages != 0, syncWithBenchParent);
+            _exit(0);
+        }
+
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        const int counter = (int)syscall(SYS_perf_event_open, &attr, child, -1, -1, 0);
+        resumeBenchChild();
+
+        // Warmed up, count the measured frames only
+        waitForBenchChild();
+        if(counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        resumeBenchChild();
+        waitForBenchChild();
+        if(counter >= 0) ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        resumeBenchChild();
+        waitpid(child, nullptr, 0);
+
+        // The counts of the child's threads are added up once they exited
+        uint64_t missNum = 0;
+        if(counter >= 0 && read(counter, &missNum, sizeof(missNum)) == sizeof(missNum)) {
+            printf(" dTLB misses/frame:%llu\n", (unsigned long long)(missNum / MEMORY_BENCHMARK_FRAMES));
+        } else {
+            printf(" dTLB misses: unavailable, see /proc/sys/kernel/perf_event_paranoid\n");
+        }
+        if(counter >= 0) close(counter);
+        close(g_benchToParent[0]);
+        close(g_benchToParent[1]);
+        close(g_benchToChild[0]);
+        close(g_benchToChild[1]);
+#else
+        renderMemoryBenchmark(hugePages != 0, nullptr);
+        printf(" dTLB misses: unavailable, measure with a profiler\n");
+#endif
+    }
+    return 0;
+}
+
+
+
 // MAIN
-int main() {
+int main(int argc, char** argv) {
+    g_context.depthFormat = DEPTH_FORMAT_FLOAT32_REVERSED;
+    g_context.vertexFormat = -1;
+    // Options first, they apply to the headless runs too
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--huge-pages") == 0) g_context.enableHugePages = true;
+        if(strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            i++;
+            for(int format = 0; format < VERTEX_FORMAT_NUM; format++) {
+                if(strcmp(argv[i], g_vertexFormatNames[format]) == 0) g_context.vertexFormat = format;
+            }
+        }
+        if(strcmp(argv[i], "--depth-format") == 0 && i + 1 < argc) {
+            i++;
+            for(int format = 0; format < DEPTH_FORMAT_NUM; format++) {
+                if(strcmp(argv[i], g_depthFormatNames[format]) == 0) g_context.depthFormat = format;
+            }
+        }
+    }
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--verify-fill") == 0) return runFillVerification();
+        if(strcmp(argv[i], "--bench-depth") == 0) return runDepthBenchmark();
+        if(strcmp(argv[i], "--bench-memory") == 0) return runMemoryBenchmark();
+        if(strcmp(argv[i], "--bench-vertex") == 0) return runVertexBenchmark();
+    }
+
     printf("Hello!\n");
     // glfw: initialize and configure
     glfwInit();
@@ -545,12 +1427,50 @@ int main() {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
 
-    static float vertexBuffer[1024 * 1024 * 20] = {};
+    const size_t vertexBufferSize = 1024 * 1024 * 20;
+    const size_t indexBufferSize = 1024 * 1024 * 10;
+    float* vertexBuffer = (float*)allocBuffer(vertexBufferSize * sizeof(float));
+    int32_t* indexBuffer = (int32_t*)allocBuffer(indexBufferSize * sizeof(int32_t));
     size_t vertexBufferLen = 0;
-    vertexBufferLen =
-        loadModel("models/swordfish.obj", &vertexBuffer[0], vertexBufferLen, staticArrayLen(vertexBuffer));
-    // vertexBufferLen = loadModel(
-    //     "models/teapot.obj", &vertexBuffer[0], vertexBufferLen, staticArrayLen(vertexBuffer), {2.5, 1, 0}, 0.1f);
+    size_t indexBufferLen = 0;
+    indexBufferLen =
+        loadModelIndexed("models/swordfish.obj", vertexBuffer, &vertexBufferLen, vertexBufferSize, indexBuffer, indexBufferLen, indexBufferSize);
+    // indexBufferLen = loadModelIndexed(
+    //     "models/teapot.obj", vertexBuffer, &vertexBufferLen, vertexBufferSize, indexBuffer, indexBufferLen, indexBufferSize, {2.5, 1, 0}, 0.1f);
+    const size_t triangleNum = indexBufferLen / 3;
+
+    const size_t vertexNum = vertexBufferLen / VERTEX_FLOATS;
+    if(g_context.vertexFormat < 0) g_context.vertexFormat = chooseVertexFormat(vertexNum);
+    uint16_t* packedVertexBuffer = nullptr;
+    size_t packedVertexBufferLen = 0;
+    Vec3 positionMin = {};
+    Vec3 positionScale = {};
+    if(g_context.vertexFormat != VERTEX_FORMAT_FLOAT) {
+        packedVertexBuffer = (uint16_t*)allocBuffer(vertexNum * VERTEX_FORMAT_BYTES(g_context.vertexFormat));
+        packedVertexBufferLen = quantizeVertices(
+            vertexBuffer, vertexBufferLen, g_context.vertexFormat, packedVertexBuffer, &positionMin, &positionScale);
+    }
+
+    // The same triangles as a float triangle list, for comparison
+    float* triangleList = (float*)allocBuffer(indexBufferLen * VERTEX_FLOATS * sizeof(float));
+    const size_t triangleListLen = expandIndexedTriangles(vertexBuffer, indexBuffer, indexBufferLen, triangleList);
+    const size_t indexedBytes = vertexNum * VERTEX_FORMAT_BYTES(g_context.vertexFormat) + indexBufferLen * sizeof(int32_t);
+    const size_t triangleListBytes = triangleListLen * sizeof(float);
+    printf(
+        "geometry: %i triangles, indexed %s %i vertices %iKB %.1fB/tri, triangle list %i vertices %iKB %.1fB/tri\n",
+        (int)triangleNum,
+        g_vertexFormatNames[g_context.vertexFormat],
+        (int)vertexNum,
+        (int)(indexedBytes / 1024),
+        (double)indexedBytes / triangleNum,
+        (int)(triangleListLen / VERTEX_FLOATS),
+        (int)(triangleListBytes / 1024),
+        (double)triangleListBytes / triangleNum);
+
+    float* clusterBounds = (float*)allocBuffer(
+        ((triangleNum + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES) * CLUSTER_BOUNDS_FLOATS * sizeof(float));
+    const size_t clusterNum = computeClusterBounds(vertexBuffer, indexBuffer, triangleNum, clusterBounds);
+    padClusterBounds(clusterBounds, clusterNum, positionScale);
 
     g_context.camera.pos = {0, 1, 2};
     g_context.cameraEuler = {};
@@ -579,23 +1499,49 @@ int main() {
         g_context.camera.rot = quatNormalize(g_context.camera.rot);
         const Mat4 transformMat4 = calcCameraMatrix(g_context.camera);
 
+        // The triangle list is only kept in VERTEX_FORMAT_FLOAT
+        const bool indexed = g_context.enableIndexedGeometry;
+        const size_t geometryBytes = indexed ? indexedBytes : triangleListBytes;
+
         const double renderBegin = glfwGetTime();
+        ispc::RenderFrameStats stats = {};
         ispc::RenderFrameParams params = {
             .framebufferColor = g_context.framebufferColor,
+            .framebufferLayout = g_context.framebufferLayout,
             .framebufferDepth = g_context.framebufferDepth,
+            .depthFormat = g_context.depthFormat,
             .frameSizeX = g_context.frameSizeX,
             .frameSizeY = g_context.frameSizeY,
-            .pointData = &vertexBuffer[0],
-            .pointNum = vertexBufferLen,
-            .transformMat4 = &transformMat4.elems[0],
-            .camera = g_context.camera.pos,
+            .pointData = indexed ? vertexBuffer : triangleList,
+            .pointNum = (int32_t)(indexed ? (packedVertexBuffer != nullptr ? packedVertexBufferLen : vertexBufferLen) : triangleListLen),
+            .indexData = indexed ? indexBuffer : nullptr,
+            .indexNum = indexed ? (int32_t)indexBufferLen : 0,
+            .vertexFormat = indexed ? g_context.vertexFormat : VERTEX_FORMAT_FLOAT,
+            .packedPointData = packedVertexBuffer,
+            .positionMin = {positionMin.x, positionMin.y, positionMin.z},
+            .positionScale = {positionScale.x, positionScale.y, positionScale.z},
+            .camera = {g_context.camera.pos.x, g_context.camera.pos.y, g_context.camera.pos.z},
+            .nearPlane = g_context.camera.nearPlane,
+            .farPlane = g_context.camera.farPlane,
             .enableWireframe = g_context.enableWriteframe,
+            .rasterMode = g_context.rasterMode,
+            .cullMode = g_context.cullMode,
+            .shadingMode = g_context.shadingMode,
+            .enableTileBuffers = g_context.enableTileBuffers,
+            .clusterBounds = clusterBounds,
+            .clusterNum = (int32_t)clusterNum,
+            .occlusionMode = g_context.occlusionMode,
+            .threadNum = getTaskThreadCount(),
+            .stats = &stats,
         };
+        memcpy(params.transformMat4, transformMat4.elems, sizeof(params.transformMat4));
 
         ispc::renderFrame(&params);
         const double renderTime = glfwGetTime() - renderBegin;
 
-        uploadFrameImageToGpu(frameTexture);
+        ispc::resolveFramebuffer(&params, g_context.framebufferResolved);
+        const double resolveTime = glfwGetTime() - renderBegin - renderTime;
+        uploadFrameImageToGpu(frameTexture, g_context.framebufferResolved);
 
         // Finish the rendering on the GPU - just draws a quad with the texture
         // on it
@@ -610,34 +1556,57 @@ int main() {
 
         // Dump info
         {
-            char infoBuf[512] = {};
+            char infoBuf[1024] = {};
             snprintf(
                 infoBuf,
                 staticArrayLen(infoBuf),
-                "dt:%fms fps:%i render:%fms x:%i y:%i vert:%ifloats",
+                "dt:%fms fps:%i render:%fms resolve:%fms x:%i y:%i verts:%i geometry:%iKB threads:%i busy min/max:%i%%/%i%% lanes:%i%% tris:%i/%i shaded:%ipx shade:%i%% hiz tri/block:%i/%i clusters total/culled/late:%i/%i/%i occluder tris:%i clear tiles:%i",
                 deltaTime * 1000.0f,
                 (int)(1.0f / deltaTime),
                 renderTime * 1000.0f,
+                resolveTime * 1000.0f,
                 g_context.frameSizeX,
                 g_context.frameSizeY,
-                vertexBufferLen);
+                stats.vertexNum,
+                (int)(geometryBytes / 1024),
+                stats.threadNum,
+                (int)(stats.threadBusyMin * 100 / (stats.threadBusyMean > 0 ? stats.threadBusyMean : 1)),
+                (int)(stats.threadBusyMax * 100 / (stats.threadBusyMean > 0 ? stats.threadBusyMean : 1)),
+                (int)(stats.rasterPixelNum * 100 / (stats.rasterLaneSlots > 0 ? stats.rasterLaneSlots : 1)),
+                stats.binnedTriangleNum,
+                stats.triangleNum,
+                (int)stats.shadedPixelNum,
+                (int)(stats.shadeCycles * 100 / (stats.threadBusyMean > 0 ? stats.threadBusyMean * stats.threadNum : 1)),
+                stats.hizTriangleRejectNum,
+                stats.hizBlockRejectNum,
+                stats.clusterNum,
+                stats.clusterCulledNum,
+                stats.clusterLateNum,
+                stats.occluderTriangleNum,
+                stats.clearTileNum);
             puts(infoBuf);
-            char titleBuf[1024] = {};
+            char titleBuf[2048] = {};
             sprintf(
                 titleBuf,
                 "ISPC Triangle Renderer  [%s] Controls: Move with WASD and "
                 "Q/E, toggle wireframe "
-                "with V, Change FOV "
+                "with V, row raster with F, no/front culling with B/N, deferred shading with G, depth pre-pass with P, linear framebuffer with M, direct framebuffer writes with L, triangle list with X, occluder pass/no occlusion culling with T/O, Change FOV "
                 "with C/Z",
                 infoBuf);
             if((frameIndex % 16) == 0) glfwSetWindowTitle(window, titleBuf);
         }
     }
 
+    freeBuffer(clusterBounds);
+    freeBuffer(triangleList);
+    freeBuffer(packedVertexBuffer);
+    freeBuffer(indexBuffer);
+    freeBuffer(vertexBuffer);
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
     return 0;
 }
 
 // Unity build
-#include "glad/glad.c"
\ No newline at end of file
+#include "glad/glad.c"
+#include "tasksys.cpp"
\ No newline at end of file
@@ -39,18 +39,63 @@ struct float3 { float v[3]; } __attribute__ ((aligned(16)));
 #endif
 #endif
 
+#ifndef __ISPC_STRUCT_RenderFrameStats__
+#define __ISPC_STRUCT_RenderFrameStats__
+struct RenderFrameStats {
+    int64_t threadBusyMin;
+    int64_t threadBusyMax;
+    int64_t threadBusyMean;
+    int32_t threadNum;
+    int64_t rasterPixelNum;
+    int64_t rasterLaneSlots;
+    int64_t shadedPixelNum;
+    int64_t shadeCycles;
+    int32_t hizTriangleRejectNum;
+    int32_t hizBlockRejectNum;
+    int32_t rasterBlockNum;
+    int32_t triangleNum;
+    int32_t binnedTriangleNum;
+    int32_t vertexNum;
+    int32_t clusterNum;
+    int32_t clusterCulledNum;
+    int32_t occluderTriangleNum;
+    int32_t clusterLateNum;
+    int32_t clearTileNum;
+};
+#endif
+
 #ifndef __ISPC_STRUCT_RenderFrameParams__
 #define __ISPC_STRUCT_RenderFrameParams__
 struct RenderFrameParams {
     uint8_t * framebufferColor;
-    uint16_t * framebufferDepth;
+    int32_t framebufferLayout;
+    uint8_t * framebufferDepth;
+    int32_t depthFormat;
     int32_t frameSizeX;
     int32_t frameSizeY;
     float * pointData;
     int32_t pointNum;
+    int32_t * indexData;
+    int32_t indexNum;
+    int32_t vertexFormat;
+    uint16_t * packedPointData;
+    float3  positionMin;
+    float3  positionScale;
     float transformMat4[4][4];
     float3  camera;
+    float nearPlane;
+    float farPlane;
     bool enableWireframe;
+    int32_t rasterMode;
+    int32_t cullMode;
+    int32_t shadingMode;
+    bool enableTileBuffers;
+    float * clusterBounds;
+    int32_t clusterNum;
+    int32_t occlusionMode;
+    int32_t * coverage;
+    int32_t threadNum;
+    struct RenderFrameStats * stats;
 };
 #endif
 
@@ -62,6 +107,7 @@ struct RenderFrameParams {
 extern "C" {
 #endif // __cplusplus
     extern void renderFrame(struct RenderFrameParams * params);
+    extern void resolveFramebuffer(struct RenderFrameParams * params, uint8_t * linearColor);
 #if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )
 } /* end extern C */
 #endif // __cplusplus
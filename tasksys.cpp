@@ -0,0 +1,200 @@
+// Minimal task system backing ispc's launch/sync.
+// ispc compiles `launch` into ISPCAlloc/ISPCLaunch calls and `sync` into ISPCSync, the host has to provide those.
+// A fixed pool of worker threads pulls task indices from the pending launches, the thread calling ISPCSync helps out
+// until its own launches are done, so nested launches from inside tasks can't deadlock.
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h> // malloc
+#include "common.h"
+
+typedef void (*IspcTaskFunc)(
+    void* data,
+    int threadIndex,
+    int threadCount,
+    int taskIndex,
+    int taskCount,
+    int taskIndex0,
+    int taskIndex1,
+    int taskIndex2,
+    int taskCount0,
+    int taskCount1,
+    int taskCount2);
+
+struct TaskLaunch {
+    IspcTaskFunc func;
+    void* data;
+    int countX;
+    int countY;
+    int countZ;
+    int count;
+    std::atomic<int> next;
+    std::atomic<int> done;
+};
+
+// One group per ispc function that launched tasks, freed by the matching ISPCSync
+struct TaskGroup {
+    std::vector<TaskLaunch*> launches;
+    std::vector<void*> allocations;
+};
+
+struct TaskSystem {
+    std::once_flag initFlag;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable launchDone;
+    std::vector<TaskLaunch*> pending;
+    std::vector<std::thread> workers;
+    int threadCount;
+};
+
+static TaskSystem g_taskSystem;
+static thread_local int g_taskThreadIndex = 0;
+
+static void executeTask(TaskLaunch* launch, const int taskIndex) {
+    const int taskIndex0 = taskIndex % launch->countX;
+    const int taskIndex1 = (taskIndex / launch->countX) % launch->countY;
+    const int taskIndex2 = taskIndex / (launch->countX * launch->countY);
+    launch->func(
+        launch->data,
+        g_taskThreadIndex,
+        g_taskSystem.threadCount,
+        taskIndex,
+        launch->count,
+        taskIndex0,
+        taskIndex1,
+        taskIndex2,
+        launch->countX,
+        launch->countY,
+        launch->countZ);
+    // The launch may be freed by ISPCSync as soon as the last task is done, don't touch it after this.
+    if(launch->done.fetch_add(1) + 1 == launch->count) {
+        std::lock_guard<std::mutex> lock(g_taskSystem.mutex);
+        g_taskSystem.launchDone.notify_all();
+    }
+}
+
+static void taskWorkerMain(const int threadIndex) {
+    g_taskThreadIndex = threadIndex;
+    TaskSystem& sys = g_taskSystem;
+    for(;;) {
+        TaskLaunch* launch = nullptr;
+        int taskIndex = 0;
+        {
+            // Tasks are claimed under the lock, so a launch can't be freed between picking it and claiming.
+            std::unique_lock<std::mutex> lock(sys.mutex);
+            sys.wakeWorkers.wait(lock, [&] { return !sys.pending.empty(); });
+            launch = sys.pending.front();
+            taskIndex = launch->next.fetch_add(1);
+            if(taskIndex >= launch->count) {
+                sys.pending.erase(sys.pending.begin());
+                continue;
+            }
+        }
+        executeTask(launch, taskIndex);
+    }
+}
+
+static void initTaskSystem() {
+    TaskSystem& sys = g_taskSystem;
+    int threadCount = (int)std::thread::hardware_concurrency();
+    if(threadCount < 1) threadCount = 1;
+    if(threadCount > RENDER_MAX_THREADS) threadCount = RENDER_MAX_THREADS;
+    sys.threadCount = threadCount;
+    // The thread that calls ISPCSync works too, it is thread index 0.
+    for(int i = 1; i < threadCount; i++) {
+        sys.workers.emplace_back(taskWorkerMain, i);
+        sys.workers.back().detach();
+    }
+}
+
+static TaskGroup* getTaskGroup(void** handlePtr) {
+    if(*handlePtr == nullptr) {
+        std::call_once(g_taskSystem.initFlag, initTaskSystem);
+        *handlePtr = new TaskGroup();
+    }
+    return (TaskGroup*)*handlePtr;
+}
+
+// Number of threads tasks can run on, including the one calling ISPCSync
+int getTaskThreadCount() {
+    std::call_once(g_taskSystem.initFlag, initTaskSystem);
+    return g_taskSystem.threadCount;
+}
+
+extern "C" {
+
+void* ISPCAlloc(void** handlePtr, int64_t size, int32_t alignment) {
+    TaskGroup* group = getTaskGroup(handlePtr);
+    // Round up so the size is a multiple of the alignment, as aligned_alloc requires.
+    const int64_t alignedSize = (size + alignment - 1) / alignment * alignment;
+#if defined(_MSC_VER)
+    void* ptr = _aligned_malloc(alignedSize, alignment);
+#else
+    void* ptr = aligned_alloc(alignment, alignedSize);
+#endif
+    group->allocations.push_back(ptr);
+    return ptr;
+}
+
+void ISPCLaunch(void** handlePtr, void* func, void* data, int countX, int countY, int countZ) {
+    TaskGroup* group = getTaskGroup(handlePtr);
+    TaskLaunch* launch = new TaskLaunch();
+    launch->func = (IspcTaskFunc)func;
+    launch->data = data;
+    launch->countX = countX;
+    launch->countY = countY;
+    launch->countZ = countZ;
+    launch->count = countX * countY * countZ;
+    launch->next = 0;
+    launch->done = 0;
+    group->launches.push_back(launch);
+    {
+        std::lock_guard<std::mutex> lock(g_taskSystem.mutex);
+        g_taskSystem.pending.push_back(launch);
+    }
+    g_taskSystem.wakeWorkers.notify_all();
+}
+
+void ISPCSync(void* handle) {
+    TaskGroup* group = (TaskGroup*)handle;
+    if(group == nullptr) {
+        return;
+    }
+    for(TaskLaunch* launch : group->launches) {
+        for(int taskIndex = launch->next.fetch_add(1); taskIndex < launch->count;
+            taskIndex = launch->next.fetch_add(1)) {
+            executeTask(launch, taskIndex);
+        }
+        std::unique_lock<std::mutex> lock(g_taskSystem.mutex);
+        g_taskSystem.launchDone.wait(lock, [&] { return launch->done.load() == launch->count; });
+    }
+    {
+        // Workers only drop launches lazily, make sure none of ours stay in the queue after they're freed.
+        std::lock_guard<std::mutex> lock(g_taskSystem.mutex);
+        std::vector<TaskLaunch*>& pending = g_taskSystem.pending;
+        for(TaskLaunch* launch : group->launches) {
+            for(size_t i = 0; i < pending.size(); i++) {
+                if(pending[i] == launch) {
+                    pending.erase(pending.begin() + i);
+                    break;
+                }
+            }
+        }
+    }
+    for(TaskLaunch* launch : group->launches) delete launch;
+    for(void* ptr : group->allocations) {
+#if defined(_MSC_VER)
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+    delete group;
+}
+
+} // extern "C"